@@ -0,0 +1,182 @@
+/***************************************************************************
+ * \file asyncio.hpp
+ * \author emma-campbell
+ * \date 2019-04-30
+ *
+ * The header file for our asynchronous file I/O classes (used when filtering
+ * a whole batch of images at once)
+ *
+ * DEPENDENCIES: <string>
+ *               <vector>
+ *               <deque>
+ *               <thread>
+ *               <mutex>
+ *               <condition_variable>
+ ***************************************************************************/
+#ifndef ASYNCIO_H
+#define ASYNCIO_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+const int MAX_IO_DEPTH = 4096;  //most files a batch can have in flight at once
+const int MAX_IO_THREADS = 64;  //most threads ThreadIO starts (past that they just fight over the disk)
+
+/**
+ * Simple completion class for a finished read or write
+ */
+class IOCompletion {
+
+    public:
+
+        int tag;                //whatever tag was handed to read()/write()/cancel()
+        bool write;             //true for a finished write (or a cancel), false for a finished read
+        bool ok;                //false if the file could not be read/written
+        bool cancelled;         //true if this came from cancel() (so ok is false, but nothing broke)
+        std::vector<char> data; //contents of the file (reads only)
+
+        //CONSTRUCTORS
+        IOCompletion() : tag(-1), write(false), ok(false), cancelled(false) {}
+        IOCompletion(int t, bool w, bool o) : tag(t), write(w), ok(o), cancelled(false) {}
+};
+
+/**
+ * Here is the AsyncIO Class. Reads and writes get started with read() & write()
+ * and return right away; wait() hands back the next one that finished (in whatever
+ * order they finish).
+ *
+ * read() & wait() are only ever called from one thread (the one running the batch),
+ * but write() & cancel() can be called from any thread (i.e. the filter workers).
+ *
+ * If the backend itself breaks, wait() returns a completion with a tag of -1, and
+ * nothing that is still in flight will ever finish.
+ *
+ * BASIC OPERATIONS:
+ *      read(int, string)          -> starts reading a whole file
+ *      write(int, string, bytes)  -> starts writing a whole file (takes the bytes)
+ *      cancel(int)                -> posts a failed completion without touching any file
+ *      wait()                     -> blocks until something finishes and returns it
+ *      name()                     -> name of the backend (for printing)
+ */
+class AsyncIO {
+
+    public:
+        virtual ~AsyncIO() {}
+
+        //BASIC OPERATIONS
+        virtual void read(int, const std::string &) = 0;
+        virtual void write(int, const std::string &, std::vector<char> &) = 0;
+        virtual void cancel(int) = 0;
+        virtual IOCompletion wait() = 0;
+        virtual const char *name() const = 0;
+};
+
+/**
+ * Thread backend: a pool of threads that each do plain blocking reads & writes,
+ * so (up to) one file per thread is in flight. Works everywhere.
+ * Extra reads & writes just wait in line for a free thread.
+ */
+class ThreadIO : public AsyncIO {
+
+    private:
+        //a read or write waiting for a free thread
+        struct Job {
+            int tag;
+            bool write;
+            bool cancel;
+            std::string path;
+            std::vector<char> data;
+        };
+
+        std::vector<std::thread> threads;
+        std::mutex lock;
+        std::condition_variable jobReady, doneReady;
+        std::deque<Job> jobs;
+        std::deque<IOCompletion> done;
+        bool stopping;
+
+        void run();
+        void push(Job &);
+
+    public:
+        //CONSTRUCTORS
+        ThreadIO(int);
+        ~ThreadIO();
+
+        //BASIC OPERATIONS
+        void read(int, const std::string &);
+        void write(int, const std::string &, std::vector<char> &);
+        void cancel(int);
+        IOCompletion wait();
+        const char *name() const { return "threads"; }
+};
+
+#ifdef HAVE_IO_URING
+/**
+ * io_uring backend: every read & write goes through one kernel submission ring, so
+ * there can be as many in flight as the ring is deep without needing a thread for each.
+ * Only on Linux 5.6 or newer (older kernels can't do READ/WRITE through the ring), and only
+ * if the kernel lets us set up a ring -- check ready().
+ */
+class UringIO : public AsyncIO {
+
+    private:
+        //a read or write the kernel is working on (its address is the user_data)
+        struct Op {
+            int tag;
+            bool write;
+            bool nop;       //nothing to read/write (goes through the ring as a NOP)
+            bool failed;    //only for a nop -- the file couldn't be opened, or it was a cancel()
+            bool cancel;    //came from cancel()
+            int fd;
+            std::vector<char> data;
+            size_t done;    //bytes read/written so far (the kernel can stop short)
+            bool published; //set (release) by submit(), checked (acquire) by wait()
+        };
+
+        int ringFd;
+        int setupError; //errno from io_uring_setup (0 if it worked)
+        bool broken;    //io_uring_enter failed for good, so wait() gives up
+        void *sqRing, *cqRing, *sqeMem;
+        size_t sqRingSize, cqRingSize, sqeMemSize;
+
+        //pointers into the shared rings
+        unsigned *sqHead, *sqTail, *sqMask, *sqArray;
+        unsigned *cqHead, *cqTail, *cqMask;
+        void *cqes;
+
+        std::mutex sqLock; //write() comes in from the filter threads
+
+        void submit(Op *);
+        void release();
+
+    public:
+        //CONSTRUCTORS
+        UringIO(int);
+        ~UringIO();
+
+        bool ready() const { return ringFd >= 0; }
+        int error() const { return setupError; }
+
+        //BASIC OPERATIONS
+        void read(int, const std::string &);
+        void write(int, const std::string &, std::vector<char> &);
+        void cancel(int);
+        IOCompletion wait();
+        const char *name() const { return "io_uring"; }
+};
+#endif
+
+/**
+ * \brief makes the AsyncIO backend with the given name ("threads" or "uring")
+ *
+ * asking for "uring" falls back to "threads" when io_uring isn't available.
+ * returns NULL for a name we don't know. the caller deletes the backend.
+ */
+AsyncIO *makeAsyncIO(const std::string &, int);
+
+#endif
@@ -37,6 +37,8 @@ typedef std::vector< std::vector<Pixel> > PixelMatrix;
  * BASIC OPERATIONS:
  *      open(string)      -> opens a bmp from a string path to the file
  *      save(string)      -> saves the bmp using a string path to the save location
+ *      fromBytes(...)    -> reads a bmp from the raw bytes of a file (i.e. read by someone else)
+ *      toBytes()         -> returns the raw bytes of the bmp file (i.e. to be written by someone else)
  *      isImage()         -> confirms that the opened image is a legit (not faulty) bmp
  *      toPixelMatrix()   -> returns the pixel data (i.e. for modification / filtering)
  *      fromPixelMatrix() -> replaces the pixel data (i.e. after modification or filtering)
@@ -51,6 +53,8 @@ class BMP {
         //BASIC OPERATIONS
         void open(std::string);
         void save(std::string);
+        void fromBytes(const std::vector<char> &, std::string);
+        std::vector<char> toBytes();
         bool isImage();
         PixelMatrix toPixelMatrix();
         void fromPixelMatrix(const PixelMatrix &);
@@ -0,0 +1,88 @@
+/***************************************************************************
+ * \file stats.hpp
+ * \author emma-campbell
+ * \date 2019-04-30
+ *
+ * The header file for our ImageStats class (histograms & channel statistics)
+ *
+ * DEPENDENCIES: <vector>
+ *               <ostream>
+ *               bmp.hpp
+ ***************************************************************************/
+#ifndef STATS_H
+#define STATS_H
+
+#include <vector>
+#include <ostream>
+#include "bmp.hpp"
+
+const int CHANNEL_BINS = 256;   //one bin per 8bit channel value
+const int HUE_BINS = 360;       //one bin per degree of hue
+
+/**
+ * Simple channel class for storing the running statistics of one color channel
+ */
+class ChannelStats {
+
+    public:
+
+        std::vector<unsigned long long> histogram;
+        int min, max;
+        unsigned long long sum, sumSquares;
+
+        //CONSTRUCTORS
+        ChannelStats() : histogram(CHANNEL_BINS, 0), min(CHANNEL_BINS), max(-1),
+                         sum(0), sumSquares(0) {}
+};
+
+/**
+ * Here is the ImageStats Class. You can find the methods in the file stats.cpp
+ *
+ * An ImageStats only ever gets touched by one thread at a time. When the image
+ * is split between threads, each thread fills its own ImageStats, and they get
+ * combined with merge() at the end (so nobody has to fight over a lock).
+ *
+ * BASIC OPERATIONS:
+ *      add(Pixel, double, double) -> counts one pixel (with its hue & saturation)
+ *      merge(ImageStats)          -> adds the counts from another ImageStats
+ *      pixelCount()               -> number of pixels counted so far
+ *      mean(int) / stddev(int)    -> mean & standard deviation of a channel
+ *      print(ostream)             -> writes a readable report
+ */
+class ImageStats {
+
+    public:
+        //CHANNELS (indexed with RED, GREEN, BLUE)
+        enum Channel { RED = 0, GREEN = 1, BLUE = 2, NUM_CHANNELS = 3 };
+        ChannelStats channels[NUM_CHANNELS];
+
+        //HUE DATA
+        std::vector<unsigned long long> hueHistogram;  //chromatic pixels only
+        unsigned long long achromatic;  //grays have no hue, so they get counted here instead
+        unsigned long long redPixels;   //chromatic pixels inside the red hue window
+
+        //CONSTRUCTORS
+        ImageStats() : hueHistogram(HUE_BINS, 0), achromatic(0), redPixels(0) {}
+
+        //BASIC OPERATIONS
+        void add(const Pixel &, double, double);
+        void merge(const ImageStats &);
+        unsigned long long pixelCount() const;
+        double mean(int) const;
+        double stddev(int) const;
+        void print(std::ostream &) const;
+};
+
+/**
+ * \brief checks if a hue is inside the red window used by filter()
+ *
+ * \param hue hue in degrees [0, 360)
+ * \return {@code true} if the hue counts as red, {@code false} otherwise
+ *
+ * red hue values generally lie between -20 and 20 (i.e. 340 -> 360 -> 20)
+ */
+inline bool isRedHue(double hue) {
+    return !(hue > 20.0 && hue < 340.0);
+}
+
+#endif
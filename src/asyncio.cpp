@@ -0,0 +1,541 @@
+/***************************************************************************
+ * \file asyncio.cpp
+ * \author emma-campbell
+ * \date 2019-04-30
+ *
+ * The exectuable file for asyncio.hpp (i.e. ThreadIO & UringIO classes). This file
+ * defines all the methods initialized in asyncio.hpp.
+ *
+ * DEPENDENCIES: asyncio.hpp
+ *              <iostream>
+ *              <fstream>
+ *              <cstring>
+ *              <cerrno>
+ *              <linux/io_uring.h> (only with HAVE_IO_URING)
+ ***************************************************************************/
+
+#include <iostream>
+#include <fstream>
+#include <cstring>
+#include <cerrno>
+#include "asyncio.hpp"
+
+#ifdef HAVE_IO_URING
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#endif
+
+/**
+ * \brief starts the I/O threads
+ *
+ * \param depth number of threads (i.e. how many files can be in flight at once)
+ */
+ThreadIO::ThreadIO(int depth) : stopping(false) {
+
+    for (int i = 0; i < depth; i++) {
+        threads.push_back(std::thread(&ThreadIO::run, this));
+    }
+}
+
+/**
+ * \brief lets the I/O threads finish what they are doing and stops them
+ */
+ThreadIO::~ThreadIO() {
+
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+    }
+    jobReady.notify_all();
+
+    for (size_t i = 0; i < threads.size(); i++) {
+        threads[i].join();
+    }
+}
+
+/**
+ * \brief what each I/O thread does: grab a job, do it, post the completion, repeat
+ * \return nothing
+ */
+void ThreadIO::run() {
+
+    while (true) {
+        std::unique_lock<std::mutex> guard(lock);
+        jobReady.wait(guard, [this] { return stopping || !jobs.empty(); });
+
+        if (jobs.empty()) {
+            return; //stopping, and nothing left to do
+        }
+
+        Job job = std::move(jobs.front());
+        jobs.pop_front();
+        guard.unlock();
+
+        IOCompletion completion(job.tag, job.write, false);
+
+        if (job.cancel) {
+            completion.cancelled = true;
+        }
+        else if (job.write) {
+            std::ofstream file(job.path.c_str(), std::ios::out | std::ios::binary);
+            file.write(job.data.data(), job.data.size());
+            completion.ok = !file.fail();
+        }
+        else {
+            std::ifstream file(job.path.c_str(), std::ios::in | std::ios::binary);
+
+            file.seekg(0, std::ios::end);
+            const std::streamoff size = file.tellg();
+
+            if (!file.fail() && size >= 0) {
+                completion.data.resize((size_t)(size));
+                file.seekg(0, std::ios::beg);
+                file.read(completion.data.data(), completion.data.size());
+                completion.ok = !file.fail();
+            }
+        }
+
+        guard.lock();
+        done.push_back(std::move(completion));
+        guard.unlock();
+        doneReady.notify_one();
+    }
+}
+
+/**
+ * \brief queues a job for the next free I/O thread
+ *
+ * \param job the job (its data gets moved out)
+ * \return nothing
+ */
+void ThreadIO::push(Job &job) {
+
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        jobs.push_back(std::move(job));
+    }
+    jobReady.notify_one();
+}
+
+/**
+ * \brief starts reading a whole file
+ *
+ * \param tag tag handed back in the completion
+ * \param path file to read
+ * \return nothing
+ */
+void ThreadIO::read(int tag, const std::string &path) {
+
+    Job job = { tag, false, false, path, std::vector<char>() };
+    push(job);
+}
+
+/**
+ * \brief starts writing a whole file
+ *
+ * \param tag tag handed back in the completion
+ * \param path file to write
+ * \param data bytes to write (swapped out, so this is left empty)
+ * \return nothing
+ */
+void ThreadIO::write(int tag, const std::string &path, std::vector<char> &data) {
+
+    Job job = { tag, true, false, path, std::vector<char>() };
+    job.data.swap(data);
+    push(job);
+}
+
+/**
+ * \brief posts a failed (write) completion without touching any file
+ *
+ * \param tag tag handed back in the completion
+ * \return nothing
+ */
+void ThreadIO::cancel(int tag) {
+
+    Job job = { tag, true, true, std::string(), std::vector<char>() };
+    push(job);
+}
+
+/**
+ * \brief blocks until a read or write finishes
+ * \return the completion
+ */
+IOCompletion ThreadIO::wait() {
+
+    std::unique_lock<std::mutex> guard(lock);
+    doneReady.wait(guard, [this] { return !done.empty(); });
+
+    IOCompletion completion = std::move(done.front());
+    done.pop_front();
+    return completion;
+}
+
+#ifdef HAVE_IO_URING
+
+//there are no glibc wrappers for these (and we don't want to depend on liburing)
+static int io_uring_setup(unsigned entries, io_uring_params *params) {
+    return (int)(syscall(__NR_io_uring_setup, entries, params));
+}
+
+static int io_uring_enter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags) {
+    return (int)(syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, NULL, 0));
+}
+
+/**
+ * \brief sets up the ring (ringFd stays -1 if the kernel won't let us)
+ *
+ * \param depth number of ring entries (i.e. how many files can be in flight at once)
+ */
+UringIO::UringIO(int depth) : ringFd(-1), setupError(0), broken(false), sqRing(MAP_FAILED), cqRing(MAP_FAILED), sqeMem(MAP_FAILED),
+                              sqRingSize(0), cqRingSize(0), sqeMemSize(0) {
+
+    io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+
+    int fd = io_uring_setup(depth, &params);
+    if (fd < 0) {
+        setupError = errno; //too old a kernel, io_uring is switched off, or depth is too big
+        return;
+    }
+
+    //5.1 - 5.5 can set up a ring, but don't know IORING_OP_READ/WRITE. RW_CUR_POS came
+    //in with them (5.6), so use it to tell
+    if ((params.features & IORING_FEAT_RW_CUR_POS) == 0) {
+        close(fd);
+        setupError = EOPNOTSUPP;
+        return;
+    }
+
+    sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    sqeMemSize = params.sq_entries * sizeof(io_uring_sqe);
+
+    //newer kernels share one mapping between the two rings
+    const bool single = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single) {
+        sqRingSize = cqRingSize = sqRingSize > cqRingSize ? sqRingSize : cqRingSize;
+    }
+
+    sqRing = mmap(NULL, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                  fd, IORING_OFF_SQ_RING);
+    cqRing = single ? sqRing : mmap(NULL, cqRingSize, PROT_READ | PROT_WRITE,
+                                    MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+    sqeMem = mmap(NULL, sqeMemSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                  fd, IORING_OFF_SQES);
+
+    if (sqRing == MAP_FAILED || cqRing == MAP_FAILED || sqeMem == MAP_FAILED) {
+        setupError = errno;
+        ringFd = fd; //so release() cleans up whatever did get mapped
+        release();
+        return;
+    }
+
+    char *sq = (char *)(sqRing);
+    sqHead = (unsigned *)(sq + params.sq_off.head);
+    sqTail = (unsigned *)(sq + params.sq_off.tail);
+    sqMask = (unsigned *)(sq + params.sq_off.ring_mask);
+    sqArray = (unsigned *)(sq + params.sq_off.array);
+
+    char *cq = (char *)(cqRing);
+    cqHead = (unsigned *)(cq + params.cq_off.head);
+    cqTail = (unsigned *)(cq + params.cq_off.tail);
+    cqMask = (unsigned *)(cq + params.cq_off.ring_mask);
+    cqes = cq + params.cq_off.cqes;
+
+    ringFd = fd;
+}
+
+/**
+ * \brief closes the ring
+ */
+UringIO::~UringIO() {
+    release();
+}
+
+/**
+ * \brief unmaps the rings and closes the ring (leaves ready() false)
+ * \return nothing
+ */
+void UringIO::release() {
+
+    if (sqeMem != MAP_FAILED) {
+        munmap(sqeMem, sqeMemSize);
+    }
+    if (cqRing != MAP_FAILED && cqRing != sqRing) {
+        munmap(cqRing, cqRingSize);
+    }
+    if (sqRing != MAP_FAILED) {
+        munmap(sqRing, sqRingSize);
+    }
+    if (ringFd >= 0) {
+        close(ringFd);
+    }
+
+    sqRing = cqRing = sqeMem = MAP_FAILED;
+    ringFd = -1;
+}
+
+/**
+ * \brief puts an op on the submission ring and hands it to the kernel
+ *
+ * \param op the op (picks up where op->done left off)
+ * \return nothing
+ */
+void UringIO::submit(Op *op) {
+
+    //read everything the sqe needs out of the op up front. once it's published, wait()
+    //on the batch thread owns it (and may already be deleting it)
+    io_uring_sqe entry;
+    std::memset(&entry, 0, sizeof(entry));
+
+    if (op->nop) {
+        entry.opcode = IORING_OP_NOP;
+        entry.fd = -1;
+    }
+    else {
+        entry.opcode = op->write ? IORING_OP_WRITE : IORING_OP_READ;
+        entry.fd = op->fd;
+        entry.addr = (unsigned long long)(op->data.data() + op->done);
+        entry.len = (unsigned)(op->data.size() - op->done);
+        entry.off = op->done;
+    }
+    entry.user_data = (unsigned long long)(op);
+
+    //the op may have been filled in by a filter thread, and wait() reads it on the batch
+    //thread. the kernel orders the hand-off through the ring, but the compiler (and tsan)
+    //can't see that -- this release pairs with the acquire in wait()
+    __atomic_store_n(&op->published, true, __ATOMIC_RELEASE);
+
+    std::lock_guard<std::mutex> guard(sqLock);
+
+    //the batch never has more files in flight than the ring is deep, so this should
+    //never be full -- but if it is, wait for the kernel to take some off first
+    const unsigned tail = *sqTail;
+    while (tail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE) > *sqMask) {
+        if (io_uring_enter(ringFd, tail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE), 0, 0) < 0 &&
+            errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+            std::cout << "io_uring submit failed: " << std::strerror(errno) << std::endl;
+            __atomic_store_n(&broken, true, __ATOMIC_RELEASE);
+            return;
+        }
+    }
+
+    const unsigned index = tail & *sqMask;
+    std::memcpy((io_uring_sqe *)(sqeMem) + index, &entry, sizeof(entry));
+
+    sqArray[index] = index;
+    __atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+
+    //submit everything the kernel hasn't taken yet (including anything a failed call left behind)
+    unsigned pending;
+    while ((pending = tail + 1 - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE)) > 0) {
+        if (io_uring_enter(ringFd, pending, 0, 0) < 0 &&
+            errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+            std::cout << "io_uring submit failed: " << std::strerror(errno) << std::endl;
+            __atomic_store_n(&broken, true, __ATOMIC_RELEASE);
+            break;
+        }
+    }
+}
+
+/**
+ * \brief starts reading a whole file
+ *
+ * \param tag tag handed back in the completion
+ * \param path file to read
+ * \return nothing
+ */
+void UringIO::read(int tag, const std::string &path) {
+
+    Op *op = new Op();
+    op->tag = tag;
+    op->write = false;
+    op->nop = false;
+    op->failed = false;
+    op->cancel = false;
+    op->done = 0;
+    op->fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+
+    //opening is quick, it's the reading that's worth doing asynchronously
+    struct stat info;
+    if (op->fd < 0 || fstat(op->fd, &info) < 0) {
+        op->nop = true;
+        op->failed = true;
+    }
+    else {
+        op->data.resize(info.st_size);
+        op->nop = op->data.empty();
+    }
+
+    submit(op);
+}
+
+/**
+ * \brief starts writing a whole file
+ *
+ * \param tag tag handed back in the completion
+ * \param path file to write
+ * \param data bytes to write (swapped out, so this is left empty)
+ * \return nothing
+ */
+void UringIO::write(int tag, const std::string &path, std::vector<char> &data) {
+
+    Op *op = new Op();
+    op->tag = tag;
+    op->write = true;
+    op->failed = false;
+    op->cancel = false;
+    op->done = 0;
+    op->data.swap(data);
+    op->fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+
+    if (op->fd < 0) {
+        op->failed = true;
+    }
+    op->nop = op->failed || op->data.empty();
+
+    submit(op);
+}
+
+/**
+ * \brief posts a failed (write) completion without touching any file
+ *
+ * \param tag tag handed back in the completion
+ * \return nothing
+ */
+void UringIO::cancel(int tag) {
+
+    Op *op = new Op();
+    op->tag = tag;
+    op->write = true;
+    op->nop = true;
+    op->failed = true;
+    op->cancel = true;
+    op->fd = -1;
+    op->done = 0;
+
+    submit(op);
+}
+
+/**
+ * \brief blocks until a read or write finishes (short reads/writes get resubmitted
+ *        here, so only whole files come back)
+ * \return the completion
+ */
+IOCompletion UringIO::wait() {
+
+    while (true) {
+        //an op that never made it onto the ring is never going to finish
+        if (__atomic_load_n(&broken, __ATOMIC_ACQUIRE)) {
+            return IOCompletion();
+        }
+
+        const unsigned head = *cqHead;
+
+        if (head == __atomic_load_n(cqTail, __ATOMIC_ACQUIRE)) {
+            if (io_uring_enter(ringFd, 0, 1, IORING_ENTER_GETEVENTS) < 0 &&
+                errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+                std::cout << "io_uring wait failed: " << std::strerror(errno) << std::endl;
+                __atomic_store_n(&broken, true, __ATOMIC_RELEASE);
+            }
+            continue;
+        }
+
+        const io_uring_cqe *cqe = (const io_uring_cqe *)(cqes) + (head & *cqMask);
+        Op *op = (Op *)(cqe->user_data);
+        const int res = cqe->res;
+        __atomic_store_n(cqHead, head + 1, __ATOMIC_RELEASE);
+
+        //pairs with the release in submit(), so everything the submitting thread wrote
+        //into the op is visible here (it is always set by the time its cqe shows up)
+        while (!__atomic_load_n(&op->published, __ATOMIC_ACQUIRE)) {
+        }
+
+        bool ok = true;
+
+        if (op->nop) {
+            ok = !op->failed;
+        }
+        else if (res < 0) {
+            ok = false;
+        }
+        else if (res == 0) {
+            //the file got shorter since we looked at it (or the disk is full)
+            op->data.resize(op->done);
+            ok = !op->write;
+        }
+        else {
+            op->done += res;
+            if (op->done < op->data.size()) {
+                submit(op); //the kernel stopped short, go again for the rest
+                continue;
+            }
+        }
+
+        if (op->fd >= 0) {
+            close(op->fd);
+        }
+
+        IOCompletion completion(op->tag, op->write, ok);
+        completion.cancelled = op->cancel;
+        if (!op->write && ok) {
+            completion.data.swap(op->data);
+        }
+
+        delete op;
+        return completion;
+    }
+}
+
+#endif
+
+/**
+ * \brief makes the AsyncIO backend with the given name ("threads" or "uring")
+ *
+ * \param backend name of the backend
+ * \param depth how many files can be in flight at once (1 to MAX_IO_DEPTH)
+ * \return the backend (the caller deletes it), or NULL for a name we don't know
+ */
+AsyncIO *makeAsyncIO(const std::string &backend, int depth) {
+
+    //no point in more threads than files in flight
+    const int threads = depth < MAX_IO_THREADS ? depth : MAX_IO_THREADS;
+
+    if (backend == "threads") {
+        return new ThreadIO(threads);
+    }
+
+    if (backend == "uring") {
+#ifdef HAVE_IO_URING
+        UringIO *uring = new UringIO(depth);
+        if (uring->ready()) {
+            return uring;
+        }
+
+        const int error = uring->error();
+        delete uring;
+
+        if (error == ENOSYS || error == EPERM) {
+            std::cout << "io_uring is not available on this system. Falling back to threads." << std::endl;
+        }
+        else if (error == EOPNOTSUPP) {
+            std::cout << "io_uring on this kernel can't read or write files (needs Linux 5.6). "
+                      << "Falling back to threads." << std::endl;
+        }
+        else {
+            std::cout << "io_uring could not set up a ring of " << depth << " entries ("
+                      << std::strerror(error) << "). Falling back to threads." << std::endl;
+        }
+#else
+        std::cout << "bmp-filter was built without io_uring. Falling back to threads." << std::endl;
+#endif
+        return new ThreadIO(threads);
+    }
+
+    return NULL;
+}
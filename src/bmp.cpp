@@ -10,11 +10,15 @@
  *              <iostream>
  *              <fstream>
  *              <cstdlib>
+ *              <cstring>
+ *              <algorithm>
  ***************************************************************************/
 
 #include <iostream>
 #include <fstream>
 #include <cstdlib>
+#include <cstring>
+#include <algorithm>
 #include "bmp.hpp"
 
 //These type defs come straight from microsoft (and are short for lazy typers like myself)
@@ -72,9 +76,6 @@ void BMP::open(std::string filename) {
 
     //clear any previously existing info --> this happens whether you are able to open
     //the file, or not
-    for (int i = 0; i < pixels.size(); i++) {
-        pixels[i].clear();
-    }
     pixels.clear();
 
     //this is checking if we have an error opening the file
@@ -84,73 +85,16 @@ void BMP::open(std::string filename) {
     }
     else {
         
-        bmpfile_magic magic; //first checking
-        file.read((char *)(&magic), sizeof(magic));
+        //slurp the whole file in one read, and let fromBytes pick it apart
+        file.seekg(0, std::ios::end);
+        const std::streamoff size = file.tellg();
 
-        // Check to make sure that the first two bytes of the file are the "BM"
-        // identifier that identifies a bitmap image.
-        if (magic.magic[0] != 'B' || magic.magic[1] != 'M') {
-            std::cout << filename << " is not in proper BMP format.\n";
-        }
-        else {
-            BITMAPFILEHEADER header; //Now, into the 'fun' stuff
-            file.read((char *)(&header), sizeof(header));
-
-            BITMAPINFOHEADER info;
-            file.read((char *)(&info), sizeof(info));
-
-            // Check for this here and so that we know later whether we need to insert
-            // each row at the bottom or top of the image.
-            bool flip = true;
-            if (info.height < 0) {
-                flip = false;
-                info.height = -info.height;
-            }
-
-            // Only support for 24-bit images
-            if (info.bits_per_pixel != 24) {
-                std::cout << filename << " uses " << info.bits_per_pixel
-                          << "bits per pixel (bit depth). BMP only supports 24bit.\n";
-            }
-
-            // No support for compressed images
-            if (info.compression != 0) {
-                std::cout << filename << " is compressed. "
-                          << "BMP only supports uncompressed images.\n";
-            }
-
-            file.seekg(header.bmp_offset); //FIND THE OFFSET!!
-
-            // Now that we have the offset, we can read the pixel data
-            for (int row = 0; row < info.height; row++)
-            {
-                std::vector<Pixel> row_data;
-
-                for (int col = 0; col < info.width; col++) {
-                    //each byte is the color. BMPs use the scheme BGR (rather than RGB)
-                    int blue = file.get(); 
-                    int green = file.get();
-                    int red = file.get();
-
-                    row_data.push_back(Pixel(red, green, blue)); //add to row
-                }
-
-                // Rows are padded so that they're always a multiple of 4 bytes.
-                // file.seekg() will skip this padding
-                file.seekg(info.width % 4, std::ios::cur);
-
-                if (flip) {
-                    //put pixels at top of matrix
-                    pixels.insert(pixels.begin(), row_data);
-                }
-                else {
-                    //put pixels at bottom
-                    pixels.push_back(row_data);
-                }
-            }
-
-            file.close();
-        } 
+        std::vector<char> bytes(size > 0 ? (size_t)(size) : 0);
+        file.seekg(0, std::ios::beg);
+        file.read(bytes.data(), bytes.size());
+        file.close();
+
+        fromBytes(bytes, filename);
     } 
 }
 
@@ -174,54 +118,159 @@ void BMP::save(std::string filename)
     }
     else {
         
-        // Now we can write all the info in the BMP structure
-        bmpfile_magic magic;
-        magic.magic[0] = 'B';
-        magic.magic[1] = 'M';
-        file.write((char *)(&magic), sizeof(magic));
-
-        //WRITING BITMAPFILEHEADER
-        BITMAPFILEHEADER header = {0};
-        header.bmp_offset = sizeof(bmpfile_magic) + sizeof(BITMAPFILEHEADER) + sizeof(BITMAPINFOHEADER);
-        header.file_size = header.bmp_offset + (pixels.size() * 3 + pixels[0].size() % 4) * pixels.size();
-        file.write((char *)(&header), sizeof(header));
-
-        //WRITING BITMAPINFOHEADER
-        BITMAPINFOHEADER info = {0};
-        info.header_size = sizeof(BITMAPINFOHEADER);
-        info.width = pixels[0].size();
-        info.height = pixels.size();
-        info.num_planes = 1;
-        info.bits_per_pixel = 24;
-        info.compression = 0;
-        info.bmp_byte_size = 0;
-        info.hres = 2835;
-        info.vres = 2835;
-        info.num_colors = 0;
-        info.num_important_colors = 0;
-        file.write((char *)(&info), sizeof(info));
-
-        // Write each row and column of Pixels into the image file -- note BMP writes rows upside down
-        for (int row = pixels.size() - 1; row >= 0; row--) {
-            const std::vector<Pixel> &row_data = pixels[row];
-
-            for (int col = 0; col < row_data.size(); col++) {
-                const Pixel &pix = row_data[col];
-                
-                //be sure that you use BGR
-                file.put((BYTE)(pix.blue));
-                file.put((BYTE)(pix.green));
-                file.put((BYTE)(pix.red));
-            }
-
-            // Rows are padded so that they're always a multiple of 4 bytes. Skip the padding.
-            for (int i = 0; i < row_data.size() % 4; i++) {
-                file.put(0);
-            }
+        std::vector<char> bytes = toBytes();
+        file.write(bytes.data(), bytes.size());
+        file.close();
+    }
+}
+
+/**
+ * \brief reads a bmp from the raw bytes of a file
+ * 
+ * \param bytes contents of the bmp file
+ * \param filename name of the file the bytes came from (for error messages)
+ * \return nothing
+ */
+void BMP::fromBytes(const std::vector<char> &bytes, std::string filename) {
+
+    //clear any previously existing info
+    pixels.clear();
+
+    bmpfile_magic magic; //first checking
+    BITMAPFILEHEADER header;
+    BITMAPINFOHEADER info;
+    const size_t headers = sizeof(magic) + sizeof(header) + sizeof(info);
+
+    // Check to make sure that the first two bytes of the file are the "BM"
+    // identifier that identifies a bitmap image.
+    if (bytes.size() < headers || bytes[0] != 'B' || bytes[1] != 'M') {
+        std::cout << filename << " is not in proper BMP format.\n";
+        return;
+    }
+
+    //Now, into the 'fun' stuff
+    std::memcpy(&header, &bytes[sizeof(magic)], sizeof(header));
+    std::memcpy(&info, &bytes[sizeof(magic) + sizeof(header)], sizeof(info));
+
+    // Check for this here and so that we know later whether we need to insert
+    // each row at the bottom or top of the image.
+    bool flip = true;
+    if (info.height < 0) {
+        flip = false;
+        info.height = -info.height;
+    }
+
+    // Only support for 24-bit images
+    if (info.bits_per_pixel != 24) {
+        std::cout << filename << " uses " << info.bits_per_pixel
+                  << "bits per pixel (bit depth). BMP only supports 24bit.\n";
+    }
+
+    // No support for compressed images
+    if (info.compression != 0) {
+        std::cout << filename << " is compressed. "
+                  << "BMP only supports uncompressed images.\n";
+    }
+
+    size_t pos = header.bmp_offset; //FIND THE OFFSET!!
+
+    // Now that we have the offset, we can read the pixel data
+    for (int row = 0; row < info.height; row++)
+    {
+        std::vector<Pixel> row_data;
+
+        for (int col = 0; col < info.width; col++) {
+            //each byte is the color. BMPs use the scheme BGR (rather than RGB)
+            //running off the end of the file gives -1 (like ifstream::get does), 
+            //which isImage() will catch
+            int blue = pos < bytes.size() ? (BYTE)(bytes[pos]) : -1;
+            int green = pos + 1 < bytes.size() ? (BYTE)(bytes[pos + 1]) : -1;
+            int red = pos + 2 < bytes.size() ? (BYTE)(bytes[pos + 2]) : -1;
+            pos += 3;
+
+            row_data.push_back(Pixel(red, green, blue)); //add to row
         }
 
-        file.close();
+        // Rows are padded so that they're always a multiple of 4 bytes. Skip the padding.
+        pos += info.width % 4;
+
+        pixels.push_back(row_data);
+
+        // No point reading rows past the end of the file, this image is already broken
+        if (pos > bytes.size()) {
+            break;
+        }
+    }
+
+    if (flip) {
+        //bottom row was read first, so put it at the bottom of the matrix
+        std::reverse(pixels.begin(), pixels.end());
+    }
+}
+
+/**
+ * \brief returns the raw bytes of the bmp file
+ * \return contents of the bmp file (empty if the bmp is not a valid image)
+ */
+std::vector<char> BMP::toBytes() {
+
+    std::vector<char> bytes;
+
+    if (!isImage()) {
+        return bytes;
+    }
+
+    // Now we can write all the info in the BMP structure
+    bmpfile_magic magic;
+    magic.magic[0] = 'B';
+    magic.magic[1] = 'M';
+
+    //WRITING BITMAPFILEHEADER
+    BITMAPFILEHEADER header = {0};
+    header.bmp_offset = sizeof(bmpfile_magic) + sizeof(BITMAPFILEHEADER) + sizeof(BITMAPINFOHEADER);
+    header.file_size = header.bmp_offset + (pixels.size() * 3 + pixels[0].size() % 4) * pixels.size();
+
+    //WRITING BITMAPINFOHEADER
+    BITMAPINFOHEADER info = {0};
+    info.header_size = sizeof(BITMAPINFOHEADER);
+    info.width = pixels[0].size();
+    info.height = pixels.size();
+    info.num_planes = 1;
+    info.bits_per_pixel = 24;
+    info.compression = 0;
+    info.bmp_byte_size = 0;
+    info.hres = 2835;
+    info.vres = 2835;
+    info.num_colors = 0;
+    info.num_important_colors = 0;
+
+    const size_t rowSize = pixels[0].size() * 3 + pixels[0].size() % 4;
+    bytes.reserve(header.bmp_offset + rowSize * pixels.size());
+
+    bytes.insert(bytes.end(), (char *)(&magic), (char *)(&magic) + sizeof(magic));
+    bytes.insert(bytes.end(), (char *)(&header), (char *)(&header) + sizeof(header));
+    bytes.insert(bytes.end(), (char *)(&info), (char *)(&info) + sizeof(info));
+
+    // Write each row and column of Pixels into the image file -- note BMP writes rows upside down
+    for (int row = pixels.size() - 1; row >= 0; row--) {
+        const std::vector<Pixel> &row_data = pixels[row];
+
+        for (int col = 0; col < row_data.size(); col++) {
+            const Pixel &pix = row_data[col];
+            
+            //be sure that you use BGR
+            bytes.push_back((BYTE)(pix.blue));
+            bytes.push_back((BYTE)(pix.green));
+            bytes.push_back((BYTE)(pix.red));
+        }
+
+        // Rows are padded so that they're always a multiple of 4 bytes. Skip the padding.
+        for (int i = 0; i < row_data.size() % 4; i++) {
+            bytes.push_back(0);
+        }
     }
+
+    return bytes;
 }
 
 /**
@@ -8,10 +8,19 @@
  * 
  * DEPENDENCIES:    bmp.hpp
  *                  bmp.cpp              
+ *                  stats.hpp
+ *                  stats.cpp
+ *                  asyncio.hpp
+ *                  asyncio.cpp
  *                  <iostream>
  *                  <fstream>
  *                  <vector>
  *                  <cmath>
+ *                  <cstring>
+ *                  <cstdlib>
+ *                  <thread>
+ *                  <chrono>
+ *                  <set>
  ***************************************************************************/
 
 // system dependencies
@@ -19,10 +28,19 @@
 #include <fstream>
 #include <vector>
 #include <cmath>
+#include <cstring>
+#include <cstdlib>
+#include <thread>
+#include <chrono>
+#include <set>
 
 //user built dependencies
 #include "bmp.hpp"
 #include "bmp.cpp"
+#include "stats.hpp"
+#include "stats.cpp"
+#include "asyncio.hpp"
+#include "asyncio.cpp"
 
 #define UNDEFINED 9999
 //HSV structure --> used for filtering process
@@ -237,29 +255,33 @@ RGB hsv2rgb(HSV in) {
 }
 
 /**
- * \brief Performs the image filtering
+ * \brief filters (and/or counts) a block of rows from the image
  * 
- * \param bmp Pixel matrix of an image
- * \return modified Pixel matrix (all grayscale except red colors)
+ * \param bmp Pixel matrix of the whole image
+ * \param out matrix the filtered rows are written into (NULL to only count)
+ * \param first first row of the block
+ * \param last one past the last row of the block
+ * \param stats stats the pixels are counted into (NULL to only filter)
+ * \return nothing
  * 
  * Filtering follows these general steps:
  *      1. Get the pixel
  *      2. Convert RGB -> HSV
- *      3. If the hue is not equal to red:
- *          4. Set saturation to 0
- *      5. Convert HSV -> RGB 
- *      6. Add the RGB pixel to the new filtered matrix
+ *      3. (count the pixel while we have its HSV anyway)
+ *      4. If the hue is not equal to red:
+ *          5. Set saturation to 0
+ *      6. Convert HSV -> RGB 
+ *      7. Add the RGB pixel to the new filtered matrix
  */ 
-std::vector< std::vector<Pixel> > filter(std::vector< std::vector<Pixel> > bmp) {
+void filterRows(const PixelMatrix &bmp, PixelMatrix *out, size_t first, size_t last,
+                ImageStats *stats) {
     
-    std::vector< std::vector<Pixel> > newBMP; //filtered matrix
     RGB rgb;     //filtered temp pixel
 
-    for (const auto &row : bmp) {
-        std::vector<Pixel> temp;
+    for (size_t row = first; row < last; row++) {
         
-        for (const auto &item : row) {
-            Pixel p = item;
+        for (size_t col = 0; col < bmp[row].size(); col++) {
+            const Pixel &p = bmp[row][col];
 
             rgb.r = p.red;
             rgb.g = p.green;
@@ -268,27 +290,388 @@ std::vector< std::vector<Pixel> > filter(std::vector< std::vector<Pixel> > bmp)
             //conversion to HSV
             HSV h = rgb2hsv(rgb);
 
+            if (stats != NULL) {
+                stats->add(p, h.h, h.s);
+            }
+
+            if (out == NULL) {
+                continue;
+            }
+
             //as specified by handout, red hue values generally lie between
             //-20 and 20 (also checks that it is not white)
-            if (h.h > 20.0 && h.h < 340.0) {
+            if (!isRedHue(h.h)) {
                 h.s = 0;
             }
 
             //convert back to RGB
             rgb = hsv2rgb(h);
 
-            //create new pixel and add to row
-            Pixel newPix = Pixel(rgb.r, rgb.g, rgb.b);
-            temp.push_back(newPix);
+            //create new pixel and put it in the row
+            (*out)[row][col] = Pixel(rgb.r, rgb.g, rgb.b);
         }
-        //add row to the Matrix
-        newBMP.push_back(temp);
     }
+}
+
+/**
+ * \brief splits the rows of an image between threads and runs filterRows on each block
+ * 
+ * \param bmp Pixel matrix of an image
+ * \param out matrix for the filtered pixels (NULL to only count)
+ * \param stats stats the pixels are counted into (NULL to only filter)
+ * \param workers number of threads (0 for one per core)
+ * \return nothing
+ * 
+ * Every thread counts into its own ImageStats, and they all get merged once the
+ * threads are done -- this way the threads never have to share a histogram.
+ */ 
+void runPass(const PixelMatrix &bmp, PixelMatrix *out, ImageStats *stats, size_t workers) {
+
+    if (workers == 0) {
+        workers = std::thread::hardware_concurrency();
+    }
+    if (workers == 0) {
+        workers = 1; //hardware_concurrency() is allowed to not know
+    }
+    if (workers > bmp.size()) {
+        workers = bmp.size();
+    }
+    if (workers <= 1) {
+        filterRows(bmp, out, 0, bmp.size(), stats);
+        return;
+    }
+
+    std::vector<ImageStats> partials(stats != NULL ? workers : 0);
+    std::vector<std::thread> threads;
+    const size_t rowsPerWorker = (bmp.size() + workers - 1) / workers;
+
+    for (size_t w = 0; w < workers; w++) {
+        const size_t first = w * rowsPerWorker;
+        const size_t last = first + rowsPerWorker < bmp.size() ? first + rowsPerWorker : bmp.size();
+        ImageStats *partial = stats != NULL ? &partials[w] : NULL;
+
+        threads.push_back(std::thread(filterRows, std::cref(bmp), out, first, last, partial));
+    }
+
+    for (size_t w = 0; w < threads.size(); w++) {
+        threads[w].join();
+    }
+
+    for (size_t w = 0; w < partials.size(); w++) {
+        stats->merge(partials[w]);
+    }
+}
+
+/**
+ * \brief Performs the image filtering
+ * 
+ * \param bmp Pixel matrix of an image
+ * \param stats if not NULL, the image statistics get counted in the same pass
+ * \param workers number of threads to split the image between (0 for one per core)
+ * \return modified Pixel matrix (all grayscale except red colors)
+ * 
+ * See filterRows for the steps of the filter.
+ */ 
+std::vector< std::vector<Pixel> > filter(const std::vector< std::vector<Pixel> > &bmp,
+                                         ImageStats *stats = NULL, size_t workers = 0) {
+    
+    //filtered matrix (same shape as the original)
+    std::vector< std::vector<Pixel> > newBMP(bmp.size());
+    for (size_t row = 0; row < bmp.size(); row++) {
+        newBMP[row].resize(bmp[row].size());
+    }
+
+    runPass(bmp, &newBMP, stats, workers);
 
     //return the filtered matrix
     return newBMP;
 }
 
+/**
+ * \brief computes the statistics of an image without filtering it
+ * 
+ * \param bmp Pixel matrix of an image
+ * \return histograms, min/max/mean and red pixel count of the image
+ */ 
+ImageStats analyze(const std::vector< std::vector<Pixel> > &bmp) {
+    
+    ImageStats stats;
+    runPass(bmp, NULL, &stats, 0);
+    return stats;
+}
+
+/**
+ * \brief where a batch image gets saved: the out directory plus the name of the infile
+ * 
+ * \param outdir directory the filtered images go into
+ * \param infile path to the original image
+ * \return path to save the filtered image to
+ */ 
+std::string batchOutfile(const std::string &outdir, const std::string &infile) {
+    
+    size_t slash = infile.find_last_of('/');
+    return outdir + "/" + (slash == std::string::npos ? infile : infile.substr(slash + 1));
+}
+
+/**
+ * \brief filters a batch of images one after the other (BMP::open -> filter -> BMP::save)
+ * 
+ * \param files paths to the images
+ * \param outdir directory the filtered images go into
+ * \return number of images that got filtered
+ */ 
+int runStreamBatch(const std::vector<std::string> &files, const std::string &outdir) {
+    
+    int filtered = 0;
+
+    for (size_t i = 0; i < files.size(); i++) {
+        BMP img;
+        img.open(files[i]);
+
+        if (!img.isImage()) {
+            std::cout << "Image " << files[i] << " could not be loaded correctly." << std::endl;
+            continue;
+        }
+
+        img.fromPixelMatrix(filter(img.toPixelMatrix()));
+        img.save(batchOutfile(outdir, files[i]));
+        filtered++;
+    }
+
+    return filtered;
+}
+
+//images that have been read, waiting for a filter thread
+struct FilterQueue {
+    std::mutex lock;
+    std::condition_variable ready;
+    std::deque<IOCompletion> reads;
+    bool closed;
+};
+
+/**
+ * \brief what each filter thread does: decode an image that was read, filter it,
+ *        and hand it back to the I/O backend to be written
+ * 
+ * \param queue images waiting to be filtered
+ * \param io the I/O backend
+ * \param files paths to the images (indexed by the completion tag)
+ * \param outdir directory the filtered images go into
+ * \return nothing
+ */ 
+void filterWorker(FilterQueue &queue, AsyncIO &io, const std::vector<std::string> &files,
+                  const std::string &outdir) {
+
+    while (true) {
+        std::unique_lock<std::mutex> guard(queue.lock);
+        queue.ready.wait(guard, [&queue] { return queue.closed || !queue.reads.empty(); });
+
+        if (queue.reads.empty()) {
+            return; //closed, and nothing left to filter
+        }
+
+        IOCompletion read = std::move(queue.reads.front());
+        queue.reads.pop_front();
+        guard.unlock();
+
+        BMP img;
+        img.fromBytes(read.data, files[read.tag]);
+
+        if (!img.isImage()) {
+            std::cout << "Image " << files[read.tag] << " could not be loaded correctly." << std::endl;
+            io.cancel(read.tag); //still have to let the batch know we are done with it
+            continue;
+        }
+
+        //there's already one of us per core, so each image stays on one thread
+        img.fromPixelMatrix(filter(img.toPixelMatrix(), NULL, 1));
+
+        std::vector<char> bytes = img.toBytes();
+        io.write(read.tag, batchOutfile(outdir, files[read.tag]), bytes);
+    }
+}
+
+/**
+ * \brief filters a batch of images with reads & writes going through an AsyncIO backend
+ * 
+ * \param files paths to the images
+ * \param outdir directory the filtered images go into
+ * \param io the I/O backend
+ * \param depth most images allowed in flight at once (being read, filtered or written)
+ * \return number of images that got filtered and saved
+ * 
+ * This thread keeps up to depth reads going, and hands every image to the filter
+ * threads as soon as its read finishes. The filter threads start the writes themselves.
+ */ 
+int runAsyncBatch(const std::vector<std::string> &files, const std::string &outdir,
+                  AsyncIO &io, size_t depth) {
+    
+    FilterQueue queue;
+    queue.closed = false;
+
+    size_t workers = std::thread::hardware_concurrency();
+    if (workers == 0) {
+        workers = 1;
+    }
+
+    std::vector<std::thread> threads;
+    for (size_t w = 0; w < workers; w++) {
+        threads.push_back(std::thread(filterWorker, std::ref(queue), std::ref(io),
+                                      std::cref(files), std::cref(outdir)));
+    }
+
+    size_t next = 0;       //next file to read
+    size_t inFlight = 0;   //images read (or being read) but not finished
+    size_t finished = 0;
+    int saved = 0;
+
+    while (finished < files.size()) {
+        
+        //keep the pipe full
+        while (next < files.size() && inFlight < depth) {
+            io.read(next, files[next]);
+            next++;
+            inFlight++;
+        }
+
+        IOCompletion done = io.wait();
+
+        if (done.tag < 0) {
+            std::cout << "The " << io.name() << " backend stopped working. Stopping the batch." << std::endl;
+            break;
+        }
+
+        if (!done.write && done.ok) {
+            //read finished --> off to the filter threads
+            {
+                std::lock_guard<std::mutex> guard(queue.lock);
+                queue.reads.push_back(std::move(done));
+            }
+            queue.ready.notify_one();
+            continue;
+        }
+
+        if (!done.write) {
+            std::cout << files[done.tag] << " could not be opened. Does it exist? "
+                      << "Is it already open by another program?" << std::endl;
+        }
+        else if (done.ok) {
+            saved++;
+        }
+        else if (!done.cancelled) {
+            std::cout << batchOutfile(outdir, files[done.tag]) << " could not be opened for editing. "
+                      << "Is it already open by another program or is it read-only?\n";
+        }
+
+        finished++;
+        inFlight--;
+    }
+
+    {
+        std::lock_guard<std::mutex> guard(queue.lock);
+        queue.closed = true;
+    }
+    queue.ready.notify_all();
+
+    for (size_t w = 0; w < threads.size(); w++) {
+        threads[w].join();
+    }
+
+    return saved;
+}
+
+/**
+ * \brief batch mode: filters a whole list of images into a directory
+ * 
+ * \param argc number of arguments after --batch
+ * \param argv arguments after --batch ([--io=<backend>] [--depth=<n>] <outdir> <infile>...)
+ * \return 0 if every image got filtered, -1 otherwise
+ * 
+ * backends are "stream" (one image at a time through BMP::open/save), "threads"
+ * and "uring" (the default -- falls back to threads if io_uring isn't available).
+ */ 
+int runBatch(int argc, char *argv[]) {
+    
+    std::string backend = "uring";
+    int depth = 32;
+    std::vector<std::string> args;
+
+    for (int i = 0; i < argc; i++) {
+        if (std::strncmp(argv[i], "--io=", 5) == 0) {
+            backend = argv[i] + 5;
+        }
+        else if (std::strncmp(argv[i], "--depth=", 8) == 0) {
+            depth = std::atoi(argv[i] + 8);
+        }
+        else {
+            args.push_back(argv[i]);
+        }
+    }
+
+    if (args.size() < 2) {
+        std::cout << "Please be sure to include an out-directory and at least one in-file.\n";
+        std::cout << "Usage: bmp-filter --batch [--io=stream|threads|uring] [--depth=<n>] "
+                  << "<outdir> <infile>...\n";
+        std::cout << "Program terminated" << std::endl;
+        return -1;
+    }
+
+    if (depth <= 0 || depth > MAX_IO_DEPTH) {
+        std::cout << "--depth has to be between 1 and " << MAX_IO_DEPTH << ".\n";
+        std::cout << "Program terminated" << std::endl;
+        return -1;
+    }
+
+    const std::string outdir = args[0];
+    const std::vector<std::string> files(args.begin() + 1, args.end());
+
+    //every image is saved under its own name, so two infiles with the same name
+    //(i.e. a/x.bmp and b/x.bmp) would both be written to the same outfile at once
+    std::set<std::string> outfiles;
+    for (size_t i = 0; i < files.size(); i++) {
+        if (!outfiles.insert(batchOutfile(outdir, files[i])).second) {
+            std::cout << "More than one in-file would be saved to " << batchOutfile(outdir, files[i])
+                      << ". Please give every in-file a different name.\n";
+            std::cout << "Program terminated" << std::endl;
+            return -1;
+        }
+    }
+
+    //never need more in flight than there are files
+    if (depth > (int)(files.size())) {
+        depth = files.size();
+    }
+
+    int filtered = 0;
+    const char *name = "stream";
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    if (backend == "stream") {
+        filtered = runStreamBatch(files, outdir);
+    }
+    else {
+        AsyncIO *io = makeAsyncIO(backend, depth);
+
+        if (io == NULL) {
+            std::cout << backend << " is not an I/O backend. Use stream, threads or uring.\n";
+            std::cout << "Program terminated" << std::endl;
+            return -1;
+        }
+
+        //restart the clock so setting up the backend doesn't count
+        name = io->name();
+        start = std::chrono::steady_clock::now();
+        filtered = runAsyncBatch(files, outdir, *io, depth);
+        delete io;
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << "Filtered " << filtered << " of " << files.size() << " images in "
+              << elapsed.count() << " seconds (" << name << ")" << std::endl;
+
+    return filtered == (int)(files.size()) ? 0 : -1;
+}
+
 int main(int argc, char* argv[]) {
     
     BMP img;    //BMP image class (bmp.hpp)
@@ -301,8 +684,26 @@ int main(int argc, char* argv[]) {
     char *infile = NULL;
     char *outfile = NULL;
 
-    if (argc != 3) { //ARGUMENTS MUST BE EQUAL TO 3 (INCLUE AN INFILE AND OUTFILE)
+    //batch mode --> everything after --batch is handled by runBatch
+    if (argc > 1 && std::strcmp(argv[1], "--batch") == 0) {
+        return runBatch(argc - 2, argv + 2);
+    }
+
+    //optional --stats flag (prints the image statistics)
+    bool wantStats = false;
+    if (argc > 1 && std::strcmp(argv[1], "--stats") == 0) {
+        wantStats = true;
+        argv++;
+        argc--;
+    }
+
+    //ARGUMENTS MUST BE EQUAL TO 3 (INCLUE AN INFILE AND OUTFILE)
+    //the outfile can only be left off when we are just printing the stats
+    if (argc != 3 && !(wantStats && argc == 2)) {
         std::cout << "Please be sure tp include in-file and out-file.\n";
+        std::cout << "Usage: bmp-filter [--stats] <infile> <outfile>\n";
+        std::cout << "       bmp-filter --stats <infile>\n";
+        std::cout << "       bmp-filter --batch [--io=stream|threads|uring] [--depth=<n>] <outdir> <infile>...\n";
         std::cout << "Program terminated" << std::endl;
         return -1;
     }
@@ -310,7 +711,7 @@ int main(int argc, char* argv[]) {
         
         //note -> argv[0] is the name of the executable
         infile = argv[1]; //infile at first argument
-        outfile = argv[2]; //outfile at second 
+        outfile = argc == 3 ? argv[2] : NULL; //outfile at second 
 
         std::cout << "Opening " << infile << std::endl;
         
@@ -321,14 +722,25 @@ int main(int argc, char* argv[]) {
         if (valid) { //if the image was opened correctly
             
             bmp = img.toPixelMatrix(); //get the pixel info
+            ImageStats stats;
 
-            std::cout << "Filtering image" << std::endl;
-            bmp = filter(bmp);         //filter the pixel info
+            if (outfile == NULL) {
+                std::cout << "Analyzing image" << std::endl;
+                stats = analyze(bmp);      //only count the pixel info
+            }
+            else {
+                std::cout << "Filtering image" << std::endl;
+                bmp = filter(bmp, wantStats ? &stats : NULL); //filter (and count) the pixel info
 
-            img.fromPixelMatrix(bmp); //replace the previous pixel info with filtered pixels
+                img.fromPixelMatrix(bmp); //replace the previous pixel info with filtered pixels
 
-            std::cout << "Saving file to " << outfile << std::endl;
-            img.save(outfile);         //save to the outfile
+                std::cout << "Saving file to " << outfile << std::endl;
+                img.save(outfile);         //save to the outfile
+            }
+
+            if (wantStats) {
+                stats.print(std::cout);
+            }
         }
         else {  //couldn't open the image :(
             std::cout << "Image " << infile << " could not be loaded correctly." << std::endl;
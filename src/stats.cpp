@@ -0,0 +1,186 @@
+/***************************************************************************
+ * \file stats.cpp
+ * \author emma-campbell
+ * \date 2019-04-30
+ *
+ * The exectuable file for stats.hpp (i.e. ImageStats class). This file defines
+ * all the methods initialized in stats.hpp.
+ *
+ * DEPENDENCIES: stats.hpp
+ *              <ostream>
+ *              <cmath>
+ ***************************************************************************/
+
+#include <ostream>
+#include <cmath>
+#include "stats.hpp"
+
+/**
+ * \brief counts one pixel
+ *
+ * \param p the pixel (RGB)
+ * \param hue hue of the pixel in degrees (from rgb2hsv)
+ * \param saturation saturation of the pixel (from rgb2hsv)
+ * \return nothing
+ */
+void ImageStats::add(const Pixel &p, double hue, double saturation) {
+
+    const int values[NUM_CHANNELS] = { p.red, p.green, p.blue };
+
+    for (int c = 0; c < NUM_CHANNELS; c++) {
+        ChannelStats &channel = channels[c];
+        const int v = values[c];
+
+        channel.histogram[v]++;
+        channel.sum += v;
+        channel.sumSquares += (unsigned long long)(v) * v;
+
+        if (v < channel.min) {
+            channel.min = v;
+        }
+        if (v > channel.max) {
+            channel.max = v;
+        }
+    }
+
+    //grays (and black) have no hue to speak of -- rgb2hsv hands back 0 (red!) for
+    //them, so we keep them out of the hue histogram and the red count
+    if (saturation <= 0.0 || std::isnan(hue)) {
+        achromatic++;
+        return;
+    }
+
+    int bin = (int)(hue);
+    if (bin >= HUE_BINS) {
+        bin = HUE_BINS - 1;
+    }
+    hueHistogram[bin]++;
+
+    if (isRedHue(hue)) {
+        redPixels++;
+    }
+}
+
+/**
+ * \brief adds the counts from another ImageStats (i.e. from another thread)
+ *
+ * \param other the stats being merged into this one
+ * \return nothing
+ */
+void ImageStats::merge(const ImageStats &other) {
+
+    for (int c = 0; c < NUM_CHANNELS; c++) {
+        ChannelStats &channel = channels[c];
+        const ChannelStats &theirs = other.channels[c];
+
+        for (int i = 0; i < CHANNEL_BINS; i++) {
+            channel.histogram[i] += theirs.histogram[i];
+        }
+
+        channel.sum += theirs.sum;
+        channel.sumSquares += theirs.sumSquares;
+        channel.min = theirs.min < channel.min ? theirs.min : channel.min;
+        channel.max = theirs.max > channel.max ? theirs.max : channel.max;
+    }
+
+    for (int i = 0; i < HUE_BINS; i++) {
+        hueHistogram[i] += other.hueHistogram[i];
+    }
+
+    achromatic += other.achromatic;
+    redPixels += other.redPixels;
+}
+
+/**
+ * \brief number of pixels counted so far
+ * \return the pixel count
+ */
+unsigned long long ImageStats::pixelCount() const {
+
+    unsigned long long count = 0;
+
+    //every pixel lands in exactly one bin of each channel, so any channel will do
+    for (int i = 0; i < CHANNEL_BINS; i++) {
+        count += channels[RED].histogram[i];
+    }
+
+    return count;
+}
+
+/**
+ * \brief mean value of a channel
+ *
+ * \param c channel (RED, GREEN or BLUE)
+ * \return the mean, or 0 if nothing was counted
+ */
+double ImageStats::mean(int c) const {
+
+    const unsigned long long count = pixelCount();
+
+    if (count == 0) {
+        return 0.0;
+    }
+
+    return (double)(channels[c].sum) / count;
+}
+
+/**
+ * \brief standard deviation of a channel
+ *
+ * \param c channel (RED, GREEN or BLUE)
+ * \return the (population) standard deviation, or 0 if nothing was counted
+ */
+double ImageStats::stddev(int c) const {
+
+    const unsigned long long count = pixelCount();
+
+    if (count == 0) {
+        return 0.0;
+    }
+
+    const double m = mean(c);
+    const double variance = (double)(channels[c].sumSquares) / count - m * m;
+
+    //rounding can push a flat channel a hair below 0
+    return variance > 0.0 ? std::sqrt(variance) : 0.0;
+}
+
+/**
+ * \brief writes a readable report of the stats
+ *
+ * \param out stream to write to
+ * \return nothing
+ */
+void ImageStats::print(std::ostream &out) const {
+
+    const char *names[NUM_CHANNELS] = { "red", "green", "blue" };
+    const unsigned long long count = pixelCount();
+
+    out << "Pixels: " << count << "\n";
+
+    for (int c = 0; c < NUM_CHANNELS; c++) {
+        out << "  " << names[c] << ":\tmin " << (count ? channels[c].min : 0)
+            << "\tmax " << (count ? channels[c].max : 0)
+            << "\tmean " << mean(c)
+            << "\tstddev " << stddev(c) << "\n";
+    }
+
+    //most common hue (by whole degree)
+    int peak = 0;
+    for (int i = 1; i < HUE_BINS; i++) {
+        if (hueHistogram[i] > hueHistogram[peak]) {
+            peak = i;
+        }
+    }
+
+    out << "  gray pixels: " << achromatic << "\n";
+    if (count > achromatic) {
+        out << "  most common hue: " << peak << " degrees\n";
+    }
+
+    out << "  red pixels: " << redPixels;
+    if (count > 0) {
+        out << " (" << 100.0 * redPixels / count << "%)";
+    }
+    out << std::endl;
+}